@@ -0,0 +1,606 @@
+// PTY-driven end-to-end harness for the interactive shell.
+//
+// Drives the built `shell` binary through a pseudo-terminal, replays scripted
+// keystroke streams and measures:
+//   - per-keystroke echo latency
+//   - Tab-completion latency for several PATH sizes
+//   - filename completion latency for several directory sizes
+//   - commands per second for non-interactive (piped) input
+// Results are written as JSON so runs can be compared between commits.
+// Exits non-zero if any scripted scenario produces unexpected output.
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+// ===== Options =====
+struct BenchOptions {
+    string shellPath = "./shell";
+    string outFile = "pty_report.json";
+    string label;
+    int echoSamples = 200;
+    int tabSamples = 50;
+    int commandCount = 2000;
+    int externalCommandCount = 200;
+    vector<int> pathSizes = {10, 1000, 10000};
+    vector<int> dirSizes = {1000, 100000};
+    int timeoutMs = 5000;
+
+    void makeQuick() {
+        echoSamples = 20;
+        tabSamples = 5;
+        commandCount = 200;
+        externalCommandCount = 20;
+        pathSizes = {10, 200};
+        dirSizes = {200};
+    }
+};
+
+// ===== Statistics =====
+struct LatencyStats {
+    size_t samples = 0;
+    double meanUs = 0, p50Us = 0, p99Us = 0, maxUs = 0;
+
+    static LatencyStats from(vector<double> values) {
+        LatencyStats stats;
+        if (values.empty()) return stats;
+        sort(values.begin(), values.end());
+        double sum = 0;
+        for (double v : values) sum += v;
+        auto at = [&](double q) { return values[min(values.size() - 1, (size_t)(q * values.size()))]; };
+        stats.samples = values.size();
+        stats.meanUs = sum / values.size();
+        stats.p50Us = at(0.50);
+        stats.p99Us = at(0.99);
+        stats.maxUs = values.back();
+        return stats;
+    }
+
+    string toJson() const {
+        stringstream ss;
+        ss << "{\"samples\": " << samples << ", \"mean_us\": " << meanUs << ", \"p50_us\": " << p50Us
+           << ", \"p99_us\": " << p99Us << ", \"max_us\": " << maxUs << "}";
+        return ss.str();
+    }
+};
+
+static double elapsedUs(Clock::time_point start) {
+    return chrono::duration<double, micro>(Clock::now() - start).count();
+}
+
+static string jsonEscape(const string& s) {
+    string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') { out += '\\'; out += c; }
+        else if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else out += c;
+    }
+    return out;
+}
+
+// ===== Temporary PATH Directory =====
+class TempPathDir {
+private:
+    string dir;
+
+public:
+    // Creates a directory holding `entries` empty executables plus one
+    // uniquely prefixed target ("zzqunique") used for completion timing.
+    explicit TempPathDir(int entries) {
+        char tmpl[] = "/tmp/pty_bench_XXXXXX";
+        if (!mkdtemp(tmpl)) { perror("mkdtemp"); exit(2); }
+        dir = tmpl;
+        for (int i = 0; i < entries; ++i) {
+            char name[32];
+            snprintf(name, sizeof(name), "/f%06d", i);
+            touchExecutable(dir + name);
+        }
+        touchExecutable(dir + "/zzqunique");
+    }
+
+    ~TempPathDir() {
+        string cmd = "rm -rf '" + dir + "'";
+        if (system(cmd.c_str()) != 0) cerr << "warning: could not remove " << dir << "\n";
+    }
+
+    const string& path() const { return dir; }
+
+    void addDirectory(const string& name) {
+        mkdir((dir + "/" + name).c_str(), 0755);
+    }
+
+    void addFile(const string& name) {
+        touchExecutable(dir + "/" + name);
+    }
+
+private:
+    static void touchExecutable(const string& file) {
+        int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0755);
+        if (fd >= 0) close(fd);
+    }
+};
+
+// ===== PTY Session =====
+class PtySession {
+private:
+    int master = -1;
+    pid_t pid = -1;
+    int timeoutMs;
+
+public:
+    // Output received since the last clear(); matched by expect().
+    string output;
+
+    // A non-empty `memoDir` keeps the shell's memo store out of ~/.cache.
+    PtySession(const string& shellPath, const string& pathEnv, int timeout, const string& memoDir = "")
+        : timeoutMs(timeout) {
+        master = posix_openpt(O_RDWR | O_NOCTTY);
+        if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+            perror("posix_openpt");
+            exit(2);
+        }
+        string slaveName = ptsname(master);
+
+        pid = fork();
+        if (pid == 0) {
+            setsid();
+            int slave = open(slaveName.c_str(), O_RDWR);
+            if (slave < 0) { perror("open slave"); _exit(127); }
+#ifdef TIOCSCTTY
+            ioctl(slave, TIOCSCTTY, 0);
+#endif
+            dup2(slave, STDIN_FILENO);
+            dup2(slave, STDOUT_FILENO);
+            dup2(slave, STDERR_FILENO);
+            if (slave > STDERR_FILENO) close(slave);
+            close(master);
+            // Start the shell with only the terminal open, whatever ctest handed us
+            long maxFd = min(sysconf(_SC_OPEN_MAX), 1024L);
+            for (int fd = STDERR_FILENO + 1; fd < maxFd; ++fd) close(fd);
+
+            setenv("PATH", pathEnv.c_str(), 1);
+            unsetenv("HISTFILE");
+            if (!memoDir.empty()) setenv("SHELL_MEMO_DIR", memoDir.c_str(), 1);
+            execl(shellPath.c_str(), shellPath.c_str(), (char*)nullptr);
+            perror("execl");
+            _exit(127);
+        } else if (pid < 0) {
+            perror("fork");
+            exit(2);
+        }
+    }
+
+    ~PtySession() {
+        if (pid > 0) {
+            kill(pid, SIGKILL);
+            waitpid(pid, nullptr, 0);
+        }
+        if (master >= 0) close(master);
+    }
+
+    void clear() { output.clear(); }
+
+    void send(const string& keys) {
+        size_t done = 0;
+        while (done < keys.size()) {
+            ssize_t n = write(master, keys.data() + done, keys.size() - done);
+            if (n <= 0) { perror("write pty"); return; }
+            done += n;
+        }
+    }
+
+    // Reads until `needle` appears in output (searching from `from`).
+    bool expect(const string& needle, size_t from = 0) {
+        auto deadline = Clock::now() + chrono::milliseconds(timeoutMs);
+        while (output.find(needle, from) == string::npos) {
+            int remaining = (int)chrono::duration_cast<chrono::milliseconds>(deadline - Clock::now()).count();
+            if (remaining <= 0 || !readSome(remaining)) return false;
+        }
+        return true;
+    }
+
+    // Reads until `needle` has appeared `count` times in output.
+    bool expectCount(const string& needle, size_t count) {
+        size_t pos = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (!expect(needle, pos)) return false;
+            pos = output.find(needle, pos) + needle.size();
+        }
+        return true;
+    }
+
+    bool waitPrompt() { return expect("$ "); }
+
+    // Sends `keys` and waits for the shell to exit; returns true on clean exit.
+    bool sendAndWaitExit(const string& keys) {
+        send(keys);
+        auto deadline = Clock::now() + chrono::milliseconds(timeoutMs);
+        while (Clock::now() < deadline) {
+            int status;
+            if (waitpid(pid, &status, WNOHANG) == pid) {
+                pid = -1;
+                return WIFEXITED(status);
+            }
+            readSome(10);
+        }
+        return false;
+    }
+
+private:
+    bool readSome(int waitMs) {
+        struct pollfd pfd = {master, POLLIN, 0};
+        if (poll(&pfd, 1, waitMs) <= 0) return false;
+        char buf[4096];
+        ssize_t n = read(master, buf, sizeof(buf));
+        if (n <= 0) return false;
+        output.append(buf, n);
+        return true;
+    }
+};
+
+// ===== Scripted Scenarios =====
+struct ScenarioResult {
+    string name;
+    bool passed;
+    string detail;
+};
+
+class ScenarioRunner {
+private:
+    PtySession& session;
+    string fileDir;
+    vector<ScenarioResult> results;
+
+    void record(const string& name, bool passed) {
+        string detail = passed ? "" : session.output;
+        results.push_back({name, passed, detail});
+        if (!passed) cerr << "scenario failed: " << name << "\n";
+    }
+
+    // Replays `keys` at the prompt and checks that `expected` shows up.
+    void run(const string& name, const string& keys, const string& expected) {
+        session.clear();
+        session.send(keys);
+        bool ok = session.expect(expected) && session.expect("$ ", session.output.find(expected) + expected.size());
+        record(name, ok);
+    }
+
+public:
+    // `dir` holds "zzqunique", "my file's" and a "sub" directory for filename completion
+    ScenarioRunner(PtySession& s, const string& dir) : session(s), fileDir(dir) {}
+
+    vector<ScenarioResult> runAll() {
+        session.clear();
+        record("prompt", session.waitPrompt());
+        run("builtin-echo", "echo pty-ok\n", "\r\npty-ok\r\n");
+        run("history-up", "\x1b[A\n", "\r\npty-ok\r\n");
+        run("history-up-down", "\x1b[A\x1b[A\x1b[B\n", "\r\npty-ok\r\n");
+        run("backspace", "echo abX\x7f" "c\n", "\r\nabc\r\n");
+        run("tab-builtin", "ech\tdone\n", "\r\ndone\r\n");
+        run("tab-path", "zzq\t\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f\x7f" "echo tab\n", "\r\ntab\r\n");
+        run("tab-file", "echo " + fileDir + "/zzq\t\n", "\r\n" + fileDir + "/zzqunique\r\n");
+        run("tab-file-dir", "echo " + fileDir + "/su\t\n", "\r\n" + fileDir + "/sub/\r\n");
+        run("tab-file-space", "echo " + fileDir + "/my\t\n", "\r\n" + fileDir + "/my file's\r\n");
+        run("tab-file-escaped-prefix", "echo " + fileDir + "/my\\ f\t\n", "\r\n" + fileDir + "/my file's\r\n");
+        run("tab-file-quoted", "echo \"" + fileDir + "/my f\t\n", "\r\n" + fileDir + "/my file's\r\n");
+        run("tab-after-pipe", "echo piped | zzq\t" + string(10, '\x7f') + "cat\n", "\r\npiped\r\n");
+        run("pipeline", "echo piped | cat\n", "\r\npiped\r\n");
+        run("redirect-file", "echo redir > " + fileDir + "/r.txt\ncat < " + fileDir + "/r.txt\n", "\r\nredir\r\n");
+        run("redirect-close-builtin", "echo a >&-\necho b\n", "\r\nb\r\n");
+        run("redirect-close-error", "cd /nonexistent-pty 2>&-\ncd /nonexistent-pty\n", "No such file or directory");
+        run("redirect-quoted", "echo \"<html>\" '2>x' \\>y\n", "\r\n<html> 2>x >y\r\n");
+        run("stats-table", "stats\n", "\r\nforks ");
+        run("stats-json", "stats --json\n", "\"name\": \"echo\"");
+        run("stats-reset", "stats reset\nstats --json\n", "\"forks\": 0");
+        run("redirect-dup-stage", "sh -c 'echo err >&2' 2>&1 | cat\n", "\r\nerr\r\n");
+        run("memo-miss-hit", "stats reset\nmemo sh -c 'echo memo-ok'\nmemo sh -c 'echo memo-ok'\nmemo\n",
+            "this session: 1 hits, 1 misses");
+        // The rewrite changes the file's size, so the stamp differs even on coarse mtimes
+        run("memo-file-invalidate",
+            "echo v1 > " + fileDir + "/m.txt\nmemo -f " + fileDir + "/m.txt cat " + fileDir + "/m.txt\n"
+            "echo v2-changed > " + fileDir + "/m.txt\nmemo -f " + fileDir + "/m.txt cat " + fileDir + "/m.txt\n",
+            "\r\nv2-changed\r\n");
+        // fd 3 was where the index used to land; it must stay free for the user
+        run("memo-index-fd", "stats reset\nmemo sh -c 'echo fd-ok'\necho x >&3\n", "\r\n3: Bad file descriptor\r\n");
+        run("memo-index-fd-hit", "memo sh -c 'echo fd-ok'\nmemo\n", "this session: 1 hits, 1 misses");
+        // The child reports what it actually got; `sh -c 'cat; nice'` checks a downstream stage
+        run("sched-nice", "sched -n 7 nice\n", "\r\n7\r\n");
+        run("sched-pipeline-inherit", "sched -a -n 4 nice | sh -c 'cat; nice'\n", "\r\n4\r\n4\r\n");
+        run("sched-pipeline-override", "sched -a -n 3 nice | sched -n 5 sh -c 'cat; nice'\n", "\r\n3\r\n5\r\n");
+        run("sched-pipeline-late-a", "echo a | sched -a cat\n", "sched: -a is only valid on the first stage\r\n");
+#ifdef __linux__
+        run("sched-spread", "sched -c 0 -a --spread cat /proc/self/status | grep Cpus_allowed_list | tr -d '\\t '\n",
+            "\r\nCpus_allowed_list:0\r\n");
+#endif
+        run("sched-builtin", "sched -n 5 echo hi\n", "sched: settings ignored for builtin echo\r\nhi\r\n");
+        run("memo-sched-order", "memo sched -n 1 sh -c 'echo order-ok'\n", "\r\norder-ok\r\n");
+
+        session.clear();
+        record("exit", session.sendAndWaitExit("exit\n"));
+        return results;
+    }
+};
+
+// ===== Measurements =====
+class PtyBench {
+private:
+    const BenchOptions& opts;
+
+    static string hostPath() {
+        const char* path = getenv("PATH");
+        return path ? path : "/usr/bin:/bin";
+    }
+
+    // Clears `chars` characters from the shell's line with backspaces.
+    static bool eraseLine(PtySession& session, size_t chars) {
+        session.clear();
+        session.send(string(chars, '\x7f'));
+        return session.expectCount("\b \b", chars);
+    }
+
+public:
+    explicit PtyBench(const BenchOptions& o) : opts(o) {}
+
+    vector<ScenarioResult> scenarios() {
+        TempPathDir dir(3);
+        dir.addDirectory("sub");
+        dir.addFile("my file's");
+        PtySession session(opts.shellPath, dir.path() + ":" + hostPath(), opts.timeoutMs, dir.path() + "/memo");
+        return ScenarioRunner(session, dir.path()).runAll();
+    }
+
+    LatencyStats echoLatency() {
+        PtySession session(opts.shellPath, hostPath(), opts.timeoutMs);
+        session.waitPrompt();
+
+        const string alphabet = "abcdefghijklmnopqrstuvwxyz";
+        vector<double> samples;
+        size_t typed = 0;
+        for (int i = 0; i < opts.echoSamples; ++i) {
+            char ch = alphabet[i % alphabet.size()];
+            session.clear();
+            auto start = Clock::now();
+            session.send(string(1, ch));
+            if (!session.expect(string(1, ch))) break;
+            samples.push_back(elapsedUs(start));
+            // Keep the line short so redraw cost does not creep in
+            if (++typed == 64) {
+                eraseLine(session, typed);
+                typed = 0;
+            }
+        }
+        eraseLine(session, typed);
+        session.sendAndWaitExit("exit\n");
+        return LatencyStats::from(samples);
+    }
+
+    LatencyStats tabLatency(int pathEntries) {
+        TempPathDir dir(pathEntries);
+        PtySession session(opts.shellPath, dir.path(), opts.timeoutMs);
+        session.waitPrompt();
+
+        const string prefix = "zzq";
+        const string completed = "zzqunique ";
+        vector<double> samples;
+        for (int i = 0; i < opts.tabSamples; ++i) {
+            session.send(prefix);
+            if (!session.expect(prefix)) break;
+            session.clear();
+            auto start = Clock::now();
+            session.send("\t");
+            if (!session.expect("unique ")) break;
+            samples.push_back(elapsedUs(start));
+            if (!eraseLine(session, completed.size())) break;
+        }
+        session.sendAndWaitExit("exit\n");
+        return LatencyStats::from(samples);
+    }
+
+    // Times completing an argument inside a directory of `entries` files.
+    LatencyStats fileTabLatency(int entries) {
+        TempPathDir dir(entries);
+        PtySession session(opts.shellPath, hostPath(), opts.timeoutMs);
+        session.waitPrompt();
+
+        const string prefix = "echo " + dir.path() + "/zzq";
+        const string completed = prefix + "unique ";
+        vector<double> samples;
+        for (int i = 0; i < opts.tabSamples; ++i) {
+            session.send(prefix);
+            if (!session.expect(prefix)) break;
+            session.clear();
+            auto start = Clock::now();
+            session.send("\t");
+            if (!session.expect("unique ")) break;
+            samples.push_back(elapsedUs(start));
+            if (!eraseLine(session, completed.size())) break;
+        }
+        session.sendAndWaitExit("exit\n");
+        return LatencyStats::from(samples);
+    }
+
+    // Feeds `count` copies of `command` on a pipe and returns commands/sec.
+    double commandsPerSecond(const string& command, int count) {
+        int in[2];
+        if (pipe(in) != 0) { perror("pipe"); return 0; }
+
+        auto start = Clock::now();
+        pid_t pid = fork();
+        if (pid == 0) {
+            dup2(in[0], STDIN_FILENO);
+            close(in[0]);
+            close(in[1]);
+            int devnull = open("/dev/null", O_WRONLY);
+            dup2(devnull, STDOUT_FILENO);
+            dup2(devnull, STDERR_FILENO);
+            close(devnull);
+            unsetenv("HISTFILE");
+            execl(opts.shellPath.c_str(), opts.shellPath.c_str(), (char*)nullptr);
+            _exit(127);
+        }
+        close(in[0]);
+
+        string script;
+        for (int i = 0; i < count; ++i) script += command + "\n";
+        script += "exit\n";
+        size_t done = 0;
+        while (done < script.size()) {
+            ssize_t n = write(in[1], script.data() + done, script.size() - done);
+            if (n <= 0) break;
+            done += n;
+        }
+        close(in[1]);
+
+        int status = 0;
+        waitpid(pid, &status, 0);
+        double seconds = elapsedUs(start) / 1e6;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) return 0;
+        return seconds > 0 ? count / seconds : 0;
+    }
+};
+
+// ===== Report =====
+static void writeReport(const BenchOptions& opts, const vector<ScenarioResult>& scenarios,
+                        const LatencyStats& echo, const vector<pair<int, LatencyStats>>& tab,
+                        const vector<pair<int, LatencyStats>>& fileTab,
+                        double builtinCps, double externalCps) {
+    ofstream out(opts.outFile);
+    if (!out.is_open()) {
+        cerr << "Error opening file: " << opts.outFile << "\n";
+        return;
+    }
+
+    out << "{\n";
+    out << "  \"label\": \"" << jsonEscape(opts.label) << "\",\n";
+    out << "  \"shell\": \"" << jsonEscape(opts.shellPath) << "\",\n";
+    out << "  \"timestamp\": " << chrono::duration_cast<chrono::seconds>(
+               chrono::system_clock::now().time_since_epoch()).count() << ",\n";
+
+    out << "  \"scenarios\": [\n";
+    for (size_t i = 0; i < scenarios.size(); ++i) {
+        out << "    {\"name\": \"" << scenarios[i].name << "\", \"passed\": "
+            << (scenarios[i].passed ? "true" : "false");
+        if (!scenarios[i].passed) out << ", \"output\": \"" << jsonEscape(scenarios[i].detail) << "\"";
+        out << "}" << (i + 1 < scenarios.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+
+    out << "  \"echo_latency\": " << echo.toJson() << ",\n";
+
+    out << "  \"tab_completion\": [\n";
+    for (size_t i = 0; i < tab.size(); ++i) {
+        out << "    {\"path_entries\": " << tab[i].first << ", \"latency\": " << tab[i].second.toJson() << "}"
+            << (i + 1 < tab.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+
+    out << "  \"file_completion\": [\n";
+    for (size_t i = 0; i < fileTab.size(); ++i) {
+        out << "    {\"dir_entries\": " << fileTab[i].first << ", \"latency\": " << fileTab[i].second.toJson() << "}"
+            << (i + 1 < fileTab.size() ? "," : "") << "\n";
+    }
+    out << "  ],\n";
+
+    out << "  \"noninteractive\": {\n";
+    out << "    \"builtin_commands\": " << opts.commandCount << ",\n";
+    out << "    \"builtin_commands_per_second\": " << builtinCps << ",\n";
+    out << "    \"external_commands\": " << opts.externalCommandCount << ",\n";
+    out << "    \"external_commands_per_second\": " << externalCps << "\n";
+    out << "  }\n";
+    out << "}\n";
+}
+
+static void usage(const char* argv0) {
+    cerr << "usage: " << argv0 << " [--shell PATH] [--out FILE] [--label TEXT] [--quick]\n"
+         << "       [--echo-samples N] [--tab-samples N] [--commands N] [--path-sizes N,N,...]\n"
+         << "       [--dir-sizes N,N,...]\n";
+}
+
+// ===== Main Function =====
+int main(int argc, char* argv[]) {
+    BenchOptions opts;
+
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        auto next = [&]() -> string {
+            if (i + 1 >= argc) { usage(argv[0]); exit(2); }
+            return argv[++i];
+        };
+        try {
+            if (arg == "--shell") opts.shellPath = next();
+            else if (arg == "--out") opts.outFile = next();
+            else if (arg == "--label") opts.label = next();
+            else if (arg == "--quick") opts.makeQuick();
+            else if (arg == "--echo-samples") opts.echoSamples = stoi(next());
+            else if (arg == "--tab-samples") opts.tabSamples = stoi(next());
+            else if (arg == "--commands") opts.commandCount = stoi(next());
+            else if (arg == "--path-sizes") {
+                opts.pathSizes.clear();
+                stringstream ss(next());
+                string size;
+                while (getline(ss, size, ',')) opts.pathSizes.push_back(stoi(size));
+            } else if (arg == "--dir-sizes") {
+                opts.dirSizes.clear();
+                stringstream ss(next());
+                string size;
+                while (getline(ss, size, ',')) opts.dirSizes.push_back(stoi(size));
+            } else { usage(argv[0]); return 2; }
+        } catch (...) {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (access(opts.shellPath.c_str(), X_OK) != 0) {
+        cerr << opts.shellPath << ": not executable\n";
+        return 2;
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    PtyBench bench(opts);
+    auto scenarios = bench.scenarios();
+    LatencyStats echo = bench.echoLatency();
+    vector<pair<int, LatencyStats>> tab;
+    for (int size : opts.pathSizes) tab.push_back({size, bench.tabLatency(size)});
+    vector<pair<int, LatencyStats>> fileTab;
+    for (int size : opts.dirSizes) fileTab.push_back({size, bench.fileTabLatency(size)});
+    double builtinCps = bench.commandsPerSecond("echo bench", opts.commandCount);
+    double externalCps = bench.commandsPerSecond("true", opts.externalCommandCount);
+
+    writeReport(opts, scenarios, echo, tab, fileTab, builtinCps, externalCps);
+
+    cout << "echo latency p50 " << echo.p50Us << "us p99 " << echo.p99Us << "us\n";
+    for (const auto& [size, stats] : tab) {
+        cout << "tab completion (" << size << " PATH entries) p50 " << stats.p50Us << "us p99 " << stats.p99Us << "us\n";
+    }
+    for (const auto& [size, stats] : fileTab) {
+        cout << "file completion (" << size << " entries) p50 " << stats.p50Us << "us p99 " << stats.p99Us << "us\n";
+    }
+    cout << "builtin commands/sec " << builtinCps << ", external commands/sec " << externalCps << "\n";
+    cout << "report written to " << opts.outFile << "\n";
+
+    bool allPassed = all_of(scenarios.begin(), scenarios.end(), [](const ScenarioResult& r) { return r.passed; });
+    bool measured = echo.samples > 0 && builtinCps > 0;
+    return allPassed && measured ? 0 : 1;
+}
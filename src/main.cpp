@@ -1,4 +1,5 @@
 #include <iostream>
+#include <memory>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -6,6 +7,9 @@
 #include <cstdlib>
 #include <cstring>
 #include <algorithm>
+#include <tuple>
+#include <cerrno>
+#include <cstdint>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/types.h>
@@ -14,6 +18,16 @@
 #include <limits.h>
 #include <termios.h>
 #include <dirent.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <poll.h>
+#include <sched.h>
+#include <unordered_map>
+#include <iomanip>
+#include <chrono>
+#include <ctime>
 
 using namespace std;
 
@@ -21,7 +35,7 @@ using namespace std;
 class ShellConfig {
 public:
     static vector<string> getBuiltinCommands() {
-        return {"echo", "exit", "type", "pwd", "cd", "history"};
+        return {"echo", "exit", "type", "pwd", "cd", "history", "sched", "memo", "stats"};
     }
     
     static bool isBuiltin(const string& cmd) {
@@ -108,6 +122,362 @@ public:
     string get(size_t index) const { return commands[index]; }
 };
 
+// ===== Session Statistics =====
+// Log-linear (HDR-style) histogram over nanosecond values. Each power of two
+// is split into 32 linear sub-buckets (~3% precision) over the full 64-bit
+// range, in a fixed array, so recording is a clz, a shift and an increment.
+class LatencyHistogram {
+private:
+    static constexpr int subBucketBits = 5;
+    static constexpr uint64_t subBucketCount = 1ull << subBucketBits;
+    static constexpr size_t bucketCount = (64 - subBucketBits + 1) * subBucketCount;
+
+    uint32_t counts[bucketCount] = {};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t maxValue = 0;
+
+    static size_t indexOf(uint64_t value) {
+        if (value < subBucketCount) return value;
+        int msb = 63 - __builtin_clzll(value);
+        int shift = msb - subBucketBits;
+        return (shift + 1) * subBucketCount + ((value >> shift) - subBucketCount);
+    }
+
+    // Midpoint of the value range covered by bucket `index`
+    static uint64_t valueAt(size_t index) {
+        if (index < subBucketCount) return index;
+        int shift = index / subBucketCount - 1;
+        uint64_t lower = (subBucketCount + index % subBucketCount) << shift;
+        return lower + ((1ull << shift) >> 1);
+    }
+
+public:
+    void record(uint64_t value) {
+        counts[indexOf(value)]++;
+        total++;
+        sum += value;
+        if (value > maxValue) maxValue = value;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t totalValue() const { return sum; }
+    uint64_t max() const { return maxValue; }
+
+    uint64_t percentile(double p) const {
+        if (total == 0) return 0;
+        uint64_t rank = (uint64_t)(p / 100.0 * total + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < bucketCount; ++i) {
+            seen += counts[i];
+            if (seen >= rank) return std::min(valueAt(i), maxValue);
+        }
+        return maxValue;
+    }
+};
+
+// Per-command timings and shell-wide counters for the `stats` builtin
+class SessionStats {
+public:
+    struct Counters {
+        uint64_t forks = 0;
+        uint64_t execs = 0;
+        uint64_t pathLookups = 0;
+        uint64_t dirCacheHits = 0;
+        uint64_t dirCacheMisses = 0;
+        uint64_t memoHits = 0;
+        uint64_t memoMisses = 0;
+    };
+
+    struct Timer {
+        uint64_t wallStart;
+    };
+
+private:
+    struct CommandStats {
+        string name;
+        LatencyHistogram wall;
+        LatencyHistogram cpu;
+    };
+
+    // Distinct names are capped so memory stays fixed; the rest share one entry
+    static constexpr size_t maxCommands = 64;
+    static constexpr const char* overflowName = "(other)";
+
+    vector<unique_ptr<CommandStats>> commands;
+    unordered_map<string, CommandStats*> byName;
+    CommandStats* lastEntry = nullptr;
+    string pipelineName;  // Reused buffer so naming a pipeline doesn't allocate
+    uint64_t pendingChildCpu = 0;
+    bool childReaped = false;
+
+    // CLOCK_MONOTONIC is served from the vDSO, so this is not a syscall
+    static uint64_t monotonicNs() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    }
+
+    CommandStats& entryFor(const string& name) {
+        // Repeating the previous command skips the hash lookup
+        if (lastEntry && lastEntry->name == name) return *lastEntry;
+        lastEntry = &lookup(name);
+        return *lastEntry;
+    }
+
+    CommandStats& lookup(const string& name) {
+        auto it = byName.find(name);
+        if (it != byName.end()) return *it->second;
+
+        string key = commands.size() < maxCommands - 1 ? name : overflowName;
+        it = byName.find(key);
+        if (it != byName.end()) return *it->second;
+        commands.push_back(make_unique<CommandStats>());
+        commands.back()->name = key;
+        byName[key] = commands.back().get();
+        return *commands.back();
+    }
+
+    static string formatDuration(uint64_t ns) {
+        stringstream ss;
+        ss << fixed << setprecision(1);
+        if (ns < 1000) ss << ns << "ns";
+        else if (ns < 1000000) ss << ns / 1e3 << "us";
+        else if (ns < 1000000000) ss << ns / 1e6 << "ms";
+        else ss << ns / 1e9 << "s";
+        return ss.str();
+    }
+
+    static string formatCpu(const LatencyHistogram& cpu, uint64_t ns) {
+        return cpu.count() == 0 ? "-" : formatDuration(ns);
+    }
+
+    static string jsonEscape(const string& text) {
+        string out;
+        for (char c : text) {
+            if (c == '"' || c == '\\') { out += '\\'; out += c; }
+            else if ((unsigned char)c < 0x20) out += ' ';
+            else out += c;
+        }
+        return out;
+    }
+
+    static void writeHistogramJson(ostream& out, const LatencyHistogram& h) {
+        if (h.count() == 0) {
+            out << "null";
+            return;
+        }
+        out << "{\"p50\": " << h.percentile(50) << ", \"p99\": " << h.percentile(99)
+            << ", \"max\": " << h.max() << ", \"total\": " << h.totalValue() << "}";
+    }
+
+    vector<const CommandStats*> sortedByTotalTime() const {
+        vector<const CommandStats*> sorted;
+        for (const auto& cmd : commands) sorted.push_back(cmd.get());
+        sort(sorted.begin(), sorted.end(), [](const CommandStats* a, const CommandStats* b) {
+            return a->wall.totalValue() > b->wall.totalValue();
+        });
+        return sorted;
+    }
+
+public:
+    Counters counters;
+
+    static SessionStats& shared() {
+        static SessionStats stats;
+        return stats;
+    }
+
+    Timer start() const {
+        return {monotonicNs()};
+    }
+
+    // Called with the rusage wait4() returns for each child a command reaps
+    void addChild(const struct rusage& usage) {
+        pendingChildCpu += ((uint64_t)usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000000ull +
+                           ((uint64_t)usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1000ull;
+        childReaped = true;
+    }
+
+    // CPU time is that of the command's children; builtins that run in the
+    // shell itself record wall time only
+    void finish(const Timer& timer, const string& name) {
+        uint64_t wall = monotonicNs() - timer.wallStart;
+        CommandStats& entry = entryFor(name);
+        entry.wall.record(wall);
+        if (childReaped) {
+            entry.cpu.record(pendingChildCpu);
+            pendingChildCpu = 0;
+            childReaped = false;
+        }
+    }
+
+    // Records a pipeline under its stage names, e.g. "ls | wc"
+    void finishPipeline(const Timer& timer, const vector<vector<string>>& stages) {
+        pipelineName.clear();
+        for (size_t i = 0; i < stages.size(); ++i) {
+            if (i > 0) pipelineName += " | ";
+            if (!stages[i].empty()) pipelineName += stages[i][0];
+        }
+        finish(timer, pipelineName);
+    }
+
+    void reset() {
+        commands.clear();
+        byName.clear();
+        lastEntry = nullptr;
+        counters = Counters();
+    }
+
+    void print(ostream& out) const {
+        out << left << setw(20) << "command" << right << setw(7) << "count"
+            << setw(10) << "total" << setw(10) << "p50" << setw(10) << "p99" << setw(10) << "max"
+            << setw(10) << "cpu p50" << setw(10) << "cpu p99" << setw(10) << "cpu max" << "\n";
+        for (const CommandStats* cmd : sortedByTotalTime()) {
+            string name = cmd->name.size() > 19 ? cmd->name.substr(0, 18) + "~" : cmd->name;
+            out << left << setw(20) << name << right << setw(7) << cmd->wall.count()
+                << setw(10) << formatDuration(cmd->wall.totalValue())
+                << setw(10) << formatDuration(cmd->wall.percentile(50))
+                << setw(10) << formatDuration(cmd->wall.percentile(99))
+                << setw(10) << formatDuration(cmd->wall.max())
+                << setw(10) << formatCpu(cmd->cpu, cmd->cpu.percentile(50))
+                << setw(10) << formatCpu(cmd->cpu, cmd->cpu.percentile(99))
+                << setw(10) << formatCpu(cmd->cpu, cmd->cpu.max()) << "\n";
+        }
+        out << "forks " << counters.forks << ", execs " << counters.execs
+            << ", PATH lookups " << counters.pathLookups << "\n";
+        out << "directory cache " << counters.dirCacheHits << " hits, " << counters.dirCacheMisses << " misses; "
+            << "memo " << counters.memoHits << " hits, " << counters.memoMisses << " misses\n";
+    }
+
+    void printJson(ostream& out) const {
+        out << "{\n  \"commands\": [\n";
+        auto sorted = sortedByTotalTime();
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            out << "    {\"name\": \"" << jsonEscape(sorted[i]->name) << "\", \"count\": " << sorted[i]->wall.count()
+                << ", \"wall_ns\": ";
+            writeHistogramJson(out, sorted[i]->wall);
+            out << ", \"cpu_ns\": ";
+            writeHistogramJson(out, sorted[i]->cpu);
+            out << "}" << (i + 1 < sorted.size() ? "," : "") << "\n";
+        }
+        out << "  ],\n  \"counters\": {"
+            << "\"forks\": " << counters.forks
+            << ", \"execs\": " << counters.execs
+            << ", \"path_lookups\": " << counters.pathLookups
+            << ", \"dir_cache_hits\": " << counters.dirCacheHits
+            << ", \"dir_cache_misses\": " << counters.dirCacheMisses
+            << ", \"memo_hits\": " << counters.memoHits
+            << ", \"memo_misses\": " << counters.memoMisses << "}\n}\n";
+    }
+};
+
+// ===== Directory Listing Cache =====
+// Sorted directory listings used by completion, keyed by the directory's
+// device/inode and mtime so a directory is only re-read after it changes.
+class DirectoryCache {
+public:
+    struct Entry {
+        string name;
+        unsigned char type;  // d_type, DT_UNKNOWN if the filesystem doesn't report it
+    };
+
+private:
+    struct Listing {
+        dev_t device = 0;
+        ino_t inode = 0;
+        struct timespec mtime = {};
+        vector<Entry> entries;  // sorted by name
+        unsigned long lastUsed = 0;
+    };
+
+    static constexpr size_t maxListings = 64;
+    unordered_map<string, Listing> listings;
+    unsigned long useCounter = 0;
+
+    static struct timespec modificationTime(const struct stat& st) {
+#ifdef __APPLE__
+        return st.st_mtimespec;
+#else
+        return st.st_mtim;
+#endif
+    }
+
+    static bool isCurrent(const Listing& listing, const struct stat& st) {
+        struct timespec mtime = modificationTime(st);
+        return listing.device == st.st_dev && listing.inode == st.st_ino &&
+               listing.mtime.tv_sec == mtime.tv_sec && listing.mtime.tv_nsec == mtime.tv_nsec;
+    }
+
+    void evictLeastRecentlyUsed() {
+        auto oldest = listings.begin();
+        for (auto it = listings.begin(); it != listings.end(); ++it) {
+            if (it->second.lastUsed < oldest->second.lastUsed) oldest = it;
+        }
+        if (oldest != listings.end()) listings.erase(oldest);
+    }
+
+    const Listing* load(const string& dir) {
+        // Stat before reading so a change made during readdir leaves a stale mtime behind
+        struct stat st;
+        if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return nullptr;
+
+        auto it = listings.find(dir);
+        if (it != listings.end() && isCurrent(it->second, st)) {
+            it->second.lastUsed = ++useCounter;
+            SessionStats::shared().counters.dirCacheHits++;
+            return &it->second;
+        }
+        SessionStats::shared().counters.dirCacheMisses++;
+
+        DIR* dirp = opendir(dir.c_str());
+        if (!dirp) return nullptr;
+
+        vector<Entry> entries;
+        struct dirent* entry;
+        while ((entry = readdir(dirp)) != nullptr) {
+            string filename = entry->d_name;
+            if (filename == "." || filename == "..") continue;
+            entries.push_back({filename, entry->d_type});
+        }
+        closedir(dirp);
+        sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.name < b.name; });
+
+        if (it == listings.end()) {
+            if (listings.size() >= maxListings) evictLeastRecentlyUsed();
+            it = listings.emplace(dir, Listing{}).first;
+        }
+        Listing& listing = it->second;
+        listing.device = st.st_dev;
+        listing.inode = st.st_ino;
+        listing.mtime = modificationTime(st);
+        listing.entries = move(entries);
+        listing.lastUsed = ++useCounter;
+        return &listing;
+    }
+
+public:
+    static DirectoryCache& shared() {
+        static DirectoryCache cache;
+        return cache;
+    }
+
+    // Entries of `dir` whose names start with `prefix`, in sorted order
+    vector<Entry> matching(const string& dir, const string& prefix) {
+        vector<Entry> matches;
+        const Listing* listing = load(dir);
+        if (!listing) return matches;
+
+        auto it = lower_bound(listing->entries.begin(), listing->entries.end(), prefix,
+                              [](const Entry& e, const string& p) { return e.name < p; });
+        for (; it != listing->entries.end() && it->name.compare(0, prefix.size(), prefix) == 0; ++it) {
+            matches.push_back(*it);
+        }
+        return matches;
+    }
+};
+
 // ===== Utility Functions =====
 class ShellUtils {
 public:
@@ -117,6 +487,7 @@ public:
     }
 
     static string findInPath(const string& program) {
+        SessionStats::shared().counters.pathLookups++;
         const char* path = getenv("PATH");
         if (!path) return "";
         
@@ -141,32 +512,61 @@ public:
         while (getline(ss, dir, ':')) {
             if (dir.empty()) continue;
             
-            DIR* dirp = opendir(dir.c_str());
-            if (!dirp) continue;
-            
-            struct dirent* entry;
-            while ((entry = readdir(dirp)) != nullptr) {
-                string filename = entry->d_name;
-                if (filename == "." || filename == "..") continue;
-                if (filename.find(prefix) != 0) continue;
-                
-                string fullPath = dir + "/" + filename;
+            for (const auto& entry : DirectoryCache::shared().matching(dir, prefix)) {
+                string fullPath = dir + "/" + entry.name;
                 if (access(fullPath.c_str(), X_OK) == 0) {
-                    if (find(executables.begin(), executables.end(), filename) == executables.end()) {
-                        executables.push_back(filename);
+                    if (find(executables.begin(), executables.end(), entry.name) == executables.end()) {
+                        executables.push_back(entry.name);
                     }
                 }
             }
-            closedir(dirp);
         }
         return executables;
     }
 
-    static vector<string> parseInput(const string &input) {
+    static bool isDirectory(const string& path) {
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    // Writes all of `data`, retrying short writes and EINTR
+    static bool writeAll(int fd, const char* data, size_t len) {
+        while (len > 0) {
+            ssize_t n = write(fd, data, len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            data += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    static int terminalColumns() {
+        struct winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) return ws.ws_col;
+        return 80;
+    }
+
+    static int terminalRows() {
+        struct winsize ws;
+        if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0) return ws.ws_row;
+        return 24;
+    }
+
+    // `quoted`, when given, receives one flag per word telling whether any
+    // part of it was quoted or escaped (so it can't be an operator)
+    static vector<string> parseInput(const string &input, vector<bool>* quoted = nullptr) {
         vector<string> args;
         string current;
         bool inQuotes = false;
+        bool currentQuoted = false;
         char quoteChar = '\0';
+        auto endWord = [&]() {
+            args.push_back(current);
+            if (quoted) quoted->push_back(currentQuoted);
+            current.clear();
+            currentQuoted = false;
+        };
 
         for (size_t i = 0; i < input.size(); ++i) {
             char c = input[i];
@@ -175,6 +575,7 @@ public:
             if (c == '\\' && i + 1 < input.size()) {
                 if (!inQuotes) {
                     current += input[++i];
+                    currentQuoted = true;
                     continue;
                 } else if (inQuotes && quoteChar == '"') {
                     char next = input[i + 1];
@@ -189,6 +590,7 @@ public:
             if ((c == '\'' || c == '"')) {
                 if (!inQuotes) {
                     inQuotes = true;
+                    currentQuoted = true;
                     quoteChar = c;
                 } else if (quoteChar == c) {
                     inQuotes = false;
@@ -196,16 +598,14 @@ public:
                     current += c;
                 }
             } else if (isspace(c) && !inQuotes) {
-                if (!current.empty()) {
-                    args.push_back(current);
-                    current.clear();
-                }
+                if (!current.empty()) endWord();
+                currentQuoted = false;
             } else {
                 current += c;
             }
         }
         
-        if (!current.empty()) args.push_back(current);
+        if (!current.empty()) endWord();
         return args;
     }
 };
@@ -217,6 +617,9 @@ public:
         vector<string> completions;
         if (prefix.empty()) return completions;
         
+        // Commands given as a path (./prog, bin/tool) complete like filenames
+        if (prefix.find('/') != string::npos) return findFileCompletions(prefix);
+        
         // Add matching builtins
         for (const auto& builtin : ShellConfig::getBuiltinCommands()) {
             if (builtin.find(prefix) == 0) {
@@ -237,6 +640,71 @@ public:
         return completions;
     }
 
+    // Completes `word` as a path, e.g. "src/ma" -> "src/main.cpp".
+    // Directories get a trailing '/'; dotfiles only match a '.' prefix.
+    static vector<string> findFileCompletions(const string& word) {
+        vector<string> completions;
+        size_t slash = word.find_last_of('/');
+        string dirPart = (slash == string::npos) ? "" : word.substr(0, slash + 1);
+        string base = (slash == string::npos) ? word : word.substr(slash + 1);
+
+        string dir = dirPart.empty() ? "." : dirPart;
+        if (dir.rfind("~/", 0) == 0 && getenv("HOME")) dir = getenv("HOME") + dir.substr(1);
+
+        bool showHidden = !base.empty() && base[0] == '.';
+        for (const auto& entry : DirectoryCache::shared().matching(dir, base)) {
+            if (entry.name[0] == '.' && !showHidden) continue;
+            
+            string completion = dirPart + entry.name;
+            bool isDir = entry.type == DT_DIR;
+            if (entry.type == DT_UNKNOWN || entry.type == DT_LNK) {
+                isDir = ShellUtils::isDirectory(dir + "/" + entry.name);
+            }
+            if (isDir) completion += "/";
+            completions.push_back(completion);
+        }
+        return completions;
+    }
+
+    // Start of the word being typed at the end of `line`, honouring
+    // backslash escapes and quotes; `openQuote` is set if a quote is unclosed
+    static size_t currentWordStart(const string& line, char& openQuote) {
+        size_t start = 0;
+        openQuote = '\0';
+        for (size_t i = 0; i < line.size(); ++i) {
+            char c = line[i];
+            if (c == '\\' && openQuote != '\'') {
+                ++i;
+            } else if (openQuote) {
+                if (c == openQuote) openQuote = '\0';
+            } else if (c == '\'' || c == '"') {
+                openQuote = c;
+            } else if (c == ' ') {
+                start = i + 1;
+            }
+        }
+        return start;
+    }
+
+    // Escapes text inserted into the line so parseInput reads it back as typed
+    static string escapeForLine(const string& text, char openQuote) {
+        const string special = openQuote == '"' ? "\"\\$" : openQuote == '\'' ? "" : " \t'\"\\|&;<>()$`*?[]#!";
+        string out;
+        for (char c : text) {
+            if (special.find(c) != string::npos) out += '\\';
+            out += c;
+        }
+        return out;
+    }
+
+    // Name shown in the completion list: the last path component
+    static string displayName(const string& completion) {
+        size_t end = completion.size();
+        if (end > 1 && completion[end - 1] == '/') end--;
+        size_t slash = completion.find_last_of('/', end - 1);
+        return (slash == string::npos) ? completion : completion.substr(slash + 1);
+    }
+
     static string findCommonPrefix(const vector<string>& strings) {
         if (strings.empty()) return "";
         string prefix = strings[0];
@@ -259,6 +727,8 @@ private:
     string currentLine;
     int historyIndex;
     int tabPressCount;
+    bool reachedEof = false;
+    char openQuote = '\0';  // Quote left open in the word being completed
 
     void handleArrowKey(char arrowType) {
         if (history.getAll().empty()) return;
@@ -280,12 +750,18 @@ private:
     }
 
     void handleTabCompletion() {
-        size_t lastSpace = line.find_last_of(' ');
-        string currentWord = (lastSpace == string::npos) ? line : line.substr(lastSpace + 1);
-
-        if (lastSpace != string::npos || currentWord.empty()) return;
-
-        auto completions = TabCompleter::findCompletions(currentWord);
+        size_t wordStart = TabCompleter::currentWordStart(line, openQuote);
+        // Completion works on the word as parseInput will see it
+        string currentWord;
+        for (const auto& part : ShellUtils::parseInput(line.substr(wordStart))) currentWord += part;
+
+        // First word, or first word after a pipe, completes as a command
+        size_t end = wordStart == 0 ? string::npos : line.find_last_not_of(' ', wordStart - 1);
+        bool commandPosition = (end == string::npos || line[end] == '|');
+        if (commandPosition && currentWord.empty()) return;
+
+        auto completions = commandPosition ? TabCompleter::findCompletions(currentWord)
+                                           : TabCompleter::findFileCompletions(currentWord);
         
         if (completions.empty()) {
             write(STDOUT_FILENO, "\a", 1);
@@ -297,7 +773,12 @@ private:
     }
 
     void completeWord(const string& completion, const string& currentWord) {
-        string toAdd = completion.substr(currentWord.size()) + " ";
+        // Leave the cursor inside a completed directory so Tab can continue
+        string toAdd = TabCompleter::escapeForLine(completion.substr(currentWord.size()), openQuote);
+        if (completion.back() != '/') {
+            if (openQuote) toAdd += openQuote;
+            toAdd += " ";
+        }
         line += toAdd;
         write(STDOUT_FILENO, toAdd.c_str(), toAdd.size());
         tabPressCount = 0;
@@ -306,7 +787,7 @@ private:
     void handleMultipleCompletions(const vector<string>& completions, const string& currentWord) {
         string lcp = TabCompleter::findCommonPrefix(completions);
         if (lcp.size() > currentWord.size()) {
-            string toAdd = lcp.substr(currentWord.size());
+            string toAdd = TabCompleter::escapeForLine(lcp.substr(currentWord.size()), openQuote);
             line += toAdd;
             write(STDOUT_FILENO, toAdd.c_str(), toAdd.size());
         } else {
@@ -319,13 +800,78 @@ private:
         }
     }
 
+    // Asks before flooding the screen, like readline's completion-query-items
+    static constexpr size_t completionQueryItems = 100;
+
     void showCompletionsList(const vector<string>& completions) {
-        string output = "\n";
-        for (const auto& comp : completions) {
-            output += comp + "  ";
+        vector<string> names;
+        for (const auto& comp : completions) names.push_back(TabCompleter::displayName(comp));
+
+        if (names.size() > completionQueryItems) {
+            string query = "\nDisplay all " + to_string(names.size()) + " possibilities? (y or n)";
+            write(STDOUT_FILENO, query.c_str(), query.size());
+            char answer = 0;
+            if (read(STDIN_FILENO, &answer, 1) != 1 || (answer != 'y' && answer != 'Y')) {
+                string prompt = "\n$ " + line;
+                write(STDOUT_FILENO, prompt.c_str(), prompt.size());
+                return;
+            }
+        }
+
+        // Short lists stay on one line; longer ones go into columns
+        size_t width = ShellUtils::terminalColumns();
+        size_t oneLineWidth = 0;
+        for (const auto& name : names) oneLineWidth += name.size() + 2;
+        if (oneLineWidth <= width) {
+            string output = "\n";
+            for (const auto& name : names) {
+                output += name + "  ";
+            }
+            output += "\n$ " + line;
+            write(STDOUT_FILENO, output.c_str(), output.size());
+            return;
+        }
+
+        write(STDOUT_FILENO, "\n", 1);
+        writePaged(formatColumns(names, width));
+        string prompt = "$ " + line;
+        write(STDOUT_FILENO, prompt.c_str(), prompt.size());
+    }
+
+    // Lays names out column-major, ls style
+    static vector<string> formatColumns(const vector<string>& names, size_t width) {
+        size_t colWidth = 0;
+        for (const auto& name : names) colWidth = max(colWidth, name.size() + 2);
+        size_t cols = max<size_t>(1, width / colWidth);
+        size_t rows = (names.size() + cols - 1) / cols;
+
+        vector<string> lines;
+        for (size_t r = 0; r < rows; ++r) {
+            string row;
+            for (size_t c = 0; c < cols; ++c) {
+                size_t i = c * rows + r;
+                if (i >= names.size()) break;
+                row += names[i];
+                if (c + 1 < cols && i + rows < names.size()) row += string(colWidth - names[i].size(), ' ');
+            }
+            lines.push_back(row + "\n");
+        }
+        return lines;
+    }
+
+    // Shows one screenful at a time; space/Enter continue, q stops
+    void writePaged(const vector<string>& lines) {
+        size_t pageSize = max(1, ShellUtils::terminalRows() - 1);
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (i > 0 && i % pageSize == 0) {
+                write(STDOUT_FILENO, "--More--", 8);
+                char key = 0;
+                bool more = read(STDIN_FILENO, &key, 1) == 1 && key != 'q' && key != 'Q';
+                write(STDOUT_FILENO, "\r\033[K", 4);
+                if (!more) return;
+            }
+            write(STDOUT_FILENO, lines[i].c_str(), lines[i].size());
         }
-        output += "\n$ " + line;
-        write(STDOUT_FILENO, output.c_str(), output.size());
     }
 
     void updateDisplay() {
@@ -348,7 +894,12 @@ public:
         line.clear();
         char ch;
         
-        while (read(STDIN_FILENO, &ch, 1) == 1) {
+        while (true) {
+            if (read(STDIN_FILENO, &ch, 1) != 1) {
+                reachedEof = true;
+                break;
+            }
+
             if (ch == '\x1b') {
                 handleEscapeSequence();
             } else if (ch == '\n') {
@@ -365,6 +916,8 @@ public:
         return line;
     }
 
+    bool atEof() const { return reachedEof; }
+
 private:
     void handleEscapeSequence() {
         char seq[2];
@@ -391,39 +944,841 @@ private:
     }
 };
 
+// ===== Scheduling Controls =====
+// CPU affinity, nice value and scheduling policy for a command or pipeline
+// stage, set with the `sched` prefix and applied in the child before exec.
+struct SchedSettings {
+    vector<int> cpus;          // empty = inherit affinity
+    bool hasNice = false;
+    int niceValue = 0;
+    bool hasPolicy = false;
+    int policy = SCHED_OTHER;
+    int priority = 0;
+    bool wholePipeline = false;
+    bool spread = false;
+    bool verbose = false;
+
+    bool empty() const { return cpus.empty() && !hasNice && !hasPolicy; }
+
+    // Fields set here take precedence over `base`
+    SchedSettings overriding(const SchedSettings& base) const {
+        SchedSettings merged = base;
+        if (!cpus.empty()) merged.cpus = cpus;
+        if (hasNice) { merged.hasNice = true; merged.niceValue = niceValue; }
+        if (hasPolicy) { merged.hasPolicy = true; merged.policy = policy; merged.priority = priority; }
+        merged.verbose = base.verbose || verbose;
+        return merged;
+    }
+
+    string describe() const;
+    void apply(const string& command) const;
+};
+
+class SchedControl {
+public:
+#ifdef CPU_SETSIZE
+    static constexpr int maxCpus = CPU_SETSIZE;
+#else
+    static constexpr int maxCpus = 1024;
+#endif
+
+    static constexpr const char* usage =
+        "usage: sched [-c CPUS] [-n NICE] [-s POLICY[:PRIO]] [-a [--spread]] [-v] [--] command [args...]\n";
+
+    // Parses "0-3,8" into sorted, de-duplicated CPU ids
+    static bool parseCpuList(const string& text, vector<int>& cpus) {
+        cpus.clear();
+        stringstream ss(text);
+        string part;
+        while (getline(ss, part, ',')) {
+            size_t dash = part.find('-');
+            try {
+                size_t used = 0;
+                int first = stoi(part.substr(0, dash), &used);
+                if (used != part.substr(0, dash).size()) return false;
+                int last = first;
+                if (dash != string::npos) {
+                    string rest = part.substr(dash + 1);
+                    last = stoi(rest, &used);
+                    if (used != rest.size()) return false;
+                }
+                if (first < 0 || last < first || last >= maxCpus) return false;
+                for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+            } catch (...) {
+                return false;
+            }
+        }
+        sort(cpus.begin(), cpus.end());
+        cpus.erase(unique(cpus.begin(), cpus.end()), cpus.end());
+        return !cpus.empty();
+    }
+
+    static string formatCpuList(const vector<int>& cpus) {
+        string out;
+        for (size_t i = 0; i < cpus.size(); ) {
+            size_t j = i;
+            while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) ++j;
+            if (!out.empty()) out += ",";
+            out += to_string(cpus[i]);
+            if (j > i) out += "-" + to_string(cpus[j]);
+            i = j + 1;
+        }
+        return out;
+    }
+
+    static bool parsePolicy(const string& text, int& policy, int& priority) {
+        size_t colon = text.find(':');
+        string name = text.substr(0, colon);
+        if (name == "other") policy = SCHED_OTHER;
+        else if (name == "fifo") policy = SCHED_FIFO;
+        else if (name == "rr") policy = SCHED_RR;
+#ifdef SCHED_BATCH
+        else if (name == "batch") policy = SCHED_BATCH;
+#endif
+#ifdef SCHED_IDLE
+        else if (name == "idle") policy = SCHED_IDLE;
+#endif
+        else return false;
+
+        priority = sched_get_priority_min(policy);
+        if (colon != string::npos) {
+            try { priority = stoi(text.substr(colon + 1)); } catch (...) { return false; }
+        }
+        return priority >= sched_get_priority_min(policy) && priority <= sched_get_priority_max(policy);
+    }
+
+    static string policyName(int policy) {
+        switch (policy) {
+            case SCHED_FIFO: return "fifo";
+            case SCHED_RR: return "rr";
+#ifdef SCHED_BATCH
+            case SCHED_BATCH: return "batch";
+#endif
+#ifdef SCHED_IDLE
+            case SCHED_IDLE: return "idle";
+#endif
+            default: return "other";
+        }
+    }
+
+    // Strips a leading `sched [options] [--]` from args into `settings`.
+    // Returns false (with `error` set) on a malformed prefix.
+    static bool parsePrefix(vector<string>& args, SchedSettings& settings, string& error) {
+        // A bare `sched` is the builtin that reports the shell's own settings
+        if (args.size() < 2 || args[0] != "sched") return true;
+
+        size_t i = 1;
+        for (; i < args.size(); ++i) {
+            const string& opt = args[i];
+            bool hasValue = i + 1 < args.size();
+            if (opt == "--") { ++i; break; }
+            else if (opt == "-a") settings.wholePipeline = true;
+            else if (opt == "--spread") settings.spread = true;
+            else if (opt == "-v") settings.verbose = true;
+            else if (opt == "-c" && hasValue) {
+                if (!parseCpuList(args[++i], settings.cpus)) { error = "invalid CPU list: " + args[i]; return false; }
+            } else if (opt == "-n" && hasValue) {
+                try { settings.niceValue = stoi(args[++i]); } catch (...) { error = "invalid nice value: " + args[i]; return false; }
+                settings.hasNice = true;
+            } else if (opt == "-s" && hasValue) {
+                if (!parsePolicy(args[++i], settings.policy, settings.priority)) { error = "invalid policy: " + args[i]; return false; }
+                settings.hasPolicy = true;
+            } else if (!opt.empty() && opt[0] == '-') {
+                error = "invalid option: " + opt;
+                return false;
+            } else {
+                break;
+            }
+        }
+
+        if (i >= args.size()) { error = "missing command"; return false; }
+        if (settings.spread && !settings.wholePipeline) { error = "--spread requires -a"; return false; }
+        args.erase(args.begin(), args.begin() + i);
+        return true;
+    }
+
+    // Orders CPUs so ones sharing a last-level (then L2) cache sit next to
+    // each other, so consecutive pipeline stages land on cache siblings.
+    static vector<int> cacheOrderedCpus(vector<int> cpus) {
+#ifdef __linux__
+        auto groupOf = [](int cpu, int wantLevel) {
+            // Lowest CPU sharing this cache level identifies the group
+            for (int index = 0; ; ++index) {
+                string base = "/sys/devices/system/cpu/cpu" + to_string(cpu) + "/cache/index" + to_string(index) + "/";
+                ifstream levelFile(base + "level");
+                if (!levelFile.is_open()) break;
+                int level = 0;
+                levelFile >> level;
+                if (level != wantLevel) continue;
+
+                ifstream sharedFile(base + "shared_cpu_list");
+                string shared;
+                vector<int> siblings;
+                if (getline(sharedFile, shared) && parseCpuList(shared, siblings)) return siblings.front();
+            }
+            return cpu;
+        };
+
+        vector<tuple<int, int, int>> keyed;
+        for (int cpu : cpus) keyed.emplace_back(groupOf(cpu, 3), groupOf(cpu, 2), cpu);
+        sort(keyed.begin(), keyed.end());
+        for (size_t i = 0; i < keyed.size(); ++i) cpus[i] = get<2>(keyed[i]);
+#endif
+        return cpus;
+    }
+
+    // Resolves per-stage settings parsed from each stage's prefix. A `sched -a`
+    // prefix on the first stage applies to every stage; a stage's own prefix overrides it.
+    static bool resolvePipeline(vector<SchedSettings>& stages, string& error) {
+        for (size_t i = 1; i < stages.size(); ++i) {
+            if (stages[i].wholePipeline) { error = "-a is only valid on the first stage"; return false; }
+        }
+
+        const SchedSettings pipeline = stages[0];
+        if (!pipeline.wholePipeline) return true;
+
+        vector<int> ordered;
+        if (pipeline.spread) {
+            // Without -c, spread over the CPUs the shell may already run on
+            ordered = cacheOrderedCpus(pipeline.cpus.empty() ? current().cpus : pipeline.cpus);
+            if (ordered.empty()) {
+                error = "--spread needs -c on this platform";
+                return false;
+            }
+        }
+        for (size_t i = 0; i < stages.size(); ++i) {
+            SchedSettings base = pipeline;
+            if (!ordered.empty()) base.cpus = {ordered[i % ordered.size()]};
+            stages[i] = (i == 0) ? base : stages[i].overriding(base);
+        }
+        return true;
+    }
+
+    // Settings of the shell process itself, shown by a bare `sched`
+    static SchedSettings current() {
+        SchedSettings settings;
+#ifdef __linux__
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &mask)) settings.cpus.push_back(cpu);
+            }
+        }
+#endif
+        errno = 0;
+        int niceValue = getpriority(PRIO_PROCESS, 0);
+        if (errno == 0) { settings.hasNice = true; settings.niceValue = niceValue; }
+#ifdef __linux__
+        int policy = sched_getscheduler(0);
+        if (policy >= 0) {
+            struct sched_param param = {};
+            sched_getparam(0, &param);
+            settings.hasPolicy = true;
+            settings.policy = policy;
+            settings.priority = param.sched_priority;
+        }
+#endif
+        return settings;
+    }
+};
+
+string SchedSettings::describe() const {
+    string out = "cpus=" + (cpus.empty() ? string("inherit") : SchedControl::formatCpuList(cpus));
+    out += " nice=" + (hasNice ? to_string(niceValue) : string("inherit"));
+    out += " policy=" + (hasPolicy ? SchedControl::policyName(policy) : string("inherit"));
+    if (hasPolicy && (policy == SCHED_FIFO || policy == SCHED_RR)) out += ":" + to_string(priority);
+    return out;
+}
+
+void SchedSettings::apply(const string& command) const {
+#ifdef __linux__
+    if (!cpus.empty()) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (int cpu : cpus) CPU_SET(cpu, &mask);
+        if (sched_setaffinity(0, sizeof(mask), &mask) != 0) perror("sched: sched_setaffinity");
+    }
+    if (hasPolicy) {
+        struct sched_param param = {};
+        param.sched_priority = priority;
+        if (sched_setscheduler(0, policy, &param) != 0) perror("sched: sched_setscheduler");
+    }
+#else
+    if (!cpus.empty()) cerr << "sched: CPU affinity is not supported on this platform\n";
+    if (hasPolicy) cerr << "sched: scheduling policies are not supported on this platform\n";
+#endif
+    if (hasNice && setpriority(PRIO_PROCESS, 0, niceValue) != 0) {
+        perror("sched: setpriority");
+    }
+    if (verbose) {
+        cerr << "sched: [" << getpid() << "] " << command << " " << describe() << "\n";
+    }
+}
+
+// ===== Command Memoization =====
+// `memo [-f FILE]... [-e VAR]... cmd` caches a deterministic command's
+// stdout, stderr and exit status. The key covers argv, the resolved
+// executable, cwd, the named env vars and (mtime, size, inode) of each
+// input file, so a hit can be replayed without forking.
+struct MemoSpec {
+    bool enabled = false;
+    vector<string> inputFiles;
+    vector<string> envVars;
+};
+
+class MemoStore {
+private:
+    static constexpr uint32_t indexMagic = 0x4d454d4f;  // "MEMO"
+    static constexpr uint32_t blobMagic = 0x4d454d42;   // "MEMB"
+    static constexpr uint32_t formatVersion = 1;
+    static constexpr uint32_t slotCount = 1024;
+
+    struct IndexHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t reserved;
+        uint64_t clock;  // LRU timestamp source, shared by all shells using the store
+    };
+
+    struct IndexSlot {
+        uint64_t hash;
+        uint64_t lastUsed;
+        uint64_t bytes;
+        uint32_t used;
+        int32_t status;
+    };
+
+    struct BlobHeader {
+        uint32_t magic;
+        int32_t status;
+        uint64_t keyLen;
+        uint64_t stdoutLen;
+        uint64_t stderrLen;
+    };
+
+    static constexpr size_t indexSize = sizeof(IndexHeader) + slotCount * sizeof(IndexSlot);
+
+    string dir;
+    int indexFd = -1;
+    void* mapping = nullptr;
+    uint64_t maxBytes = 64ull << 20;
+
+    IndexHeader* header() { return static_cast<IndexHeader*>(mapping); }
+    IndexSlot* slots() { return reinterpret_cast<IndexSlot*>(header() + 1); }
+
+    static string defaultDirectory() {
+        if (const char* dir = getenv("SHELL_MEMO_DIR")) return dir;
+        if (const char* cache = getenv("XDG_CACHE_HOME")) return string(cache) + "/basic-shell/memo";
+        if (const char* home = getenv("HOME")) return string(home) + "/.cache/basic-shell/memo";
+        return "";
+    }
+
+    static bool makeDirectories(const string& path) {
+        for (size_t pos = 1; pos != string::npos; ) {
+            pos = path.find('/', pos + 1);
+            string part = path.substr(0, pos);
+            if (mkdir(part.c_str(), 0700) != 0 && errno != EEXIST) return false;
+        }
+        return true;
+    }
+
+    string blobPath(uint64_t hash) const {
+        char name[32];
+        snprintf(name, sizeof(name), "/%016llx.memo", (unsigned long long)hash);
+        return dir + name;
+    }
+
+    // Maps the index lazily so sessions that never use `memo` pay nothing
+    bool open() {
+        if (mapping) return true;
+        if (dir.empty()) dir = defaultDirectory();
+        if (dir.empty() || !makeDirectories(dir)) {
+            cerr << "memo: cannot create cache directory\n";
+            return false;
+        }
+        if (const char* limit = getenv("SHELL_MEMO_MAX_BYTES")) {
+            try { maxBytes = stoull(limit); } catch (...) {}
+        }
+
+        string indexPath = dir + "/index";
+        int fd = ::open(indexPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            cerr << "Error opening file: " << indexPath << "\n";
+            return false;
+        }
+        // Keep the index above the fds users redirect (`>&3`, `3<x`), like applyWithSave's copies
+        indexFd = fcntl(fd, F_DUPFD_CLOEXEC, 64);
+        close(fd);
+        if (indexFd < 0) {
+            perror("memo: fcntl");
+            return false;
+        }
+        flock(indexFd, LOCK_EX);
+        struct stat st;
+        bool fresh = fstat(indexFd, &st) != 0 || (size_t)st.st_size != indexSize;
+        // Mapping a file shorter than the index would fault on first access
+        if (fresh && (ftruncate(indexFd, 0) != 0 || ftruncate(indexFd, indexSize) != 0)) {
+            perror("memo: ftruncate");
+            flock(indexFd, LOCK_UN);
+            close(indexFd);
+            indexFd = -1;
+            return false;
+        }
+        mapping = mmap(nullptr, indexSize, PROT_READ | PROT_WRITE, MAP_SHARED, indexFd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            perror("memo: mmap");
+            flock(indexFd, LOCK_UN);
+            close(indexFd);
+            indexFd = -1;
+            return false;
+        }
+        IndexHeader* h = header();
+        if (fresh || h->magic != indexMagic || h->version != formatVersion || h->slotCount != slotCount) {
+            memset(mapping, 0, indexSize);
+            *h = {indexMagic, formatVersion, slotCount, 0, 0};
+        }
+        flock(indexFd, LOCK_UN);
+        return true;
+    }
+
+    IndexSlot* findSlot(uint64_t hash) {
+        IndexSlot* table = slots();
+        for (uint32_t i = 0; i < slotCount; ++i) {
+            if (table[i].used && table[i].hash == hash) return &table[i];
+        }
+        return nullptr;
+    }
+
+    void evict(IndexSlot& slot) {
+        unlink(blobPath(slot.hash).c_str());
+        slot = {};
+    }
+
+    // Frees space for `bytes` by dropping least recently used entries; returns a free slot
+    IndexSlot* reserve(uint64_t bytes) {
+        IndexSlot* table = slots();
+        while (true) {
+            uint64_t total = 0;
+            IndexSlot* freeSlot = nullptr;
+            IndexSlot* oldest = nullptr;
+            for (uint32_t i = 0; i < slotCount; ++i) {
+                if (!table[i].used) {
+                    if (!freeSlot) freeSlot = &table[i];
+                    continue;
+                }
+                total += table[i].bytes;
+                if (!oldest || table[i].lastUsed < oldest->lastUsed) oldest = &table[i];
+            }
+            if (freeSlot && total + bytes <= maxBytes) return freeSlot;
+            if (!oldest) return nullptr;
+            evict(*oldest);
+        }
+    }
+
+public:
+    static MemoStore& shared() {
+        static MemoStore store;
+        return store;
+    }
+
+    ~MemoStore() {
+        if (mapping) munmap(mapping, indexSize);
+        if (indexFd >= 0) close(indexFd);
+    }
+
+    static uint64_t hashKey(const string& key) {
+        uint64_t hash = 1469598103934665603ull;  // FNV-1a
+        for (unsigned char c : key) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Writes a cached result to stdout/stderr; false on a miss
+    bool replay(const string& key) {
+        if (!open()) return false;
+        uint64_t hash = hashKey(key);
+        uint64_t& misses = SessionStats::shared().counters.memoMisses;
+
+        // Open the blob under the lock; the descriptor stays valid if another shell evicts it
+        flock(indexFd, LOCK_SH);
+        int fd = findSlot(hash) ? ::open(blobPath(hash).c_str(), O_RDONLY) : -1;
+        flock(indexFd, LOCK_UN);
+        if (fd < 0) { misses++; return false; }
+        struct stat st;
+        void* blob = (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(BlobHeader))
+                         ? mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (blob == MAP_FAILED) { misses++; return false; }
+
+        const BlobHeader* bh = static_cast<const BlobHeader*>(blob);
+        const char* body = static_cast<const char*>(blob) + sizeof(BlobHeader);
+        bool valid = bh->magic == blobMagic &&
+                     sizeof(BlobHeader) + bh->keyLen + bh->stdoutLen + bh->stderrLen == (uint64_t)st.st_size &&
+                     key.compare(0, string::npos, body, bh->keyLen) == 0;
+        if (valid) {
+            ShellUtils::writeAll(STDOUT_FILENO, body + bh->keyLen, bh->stdoutLen);
+            ShellUtils::writeAll(STDERR_FILENO, body + bh->keyLen + bh->stdoutLen, bh->stderrLen);
+            flock(indexFd, LOCK_EX);
+            if (IndexSlot* slot = findSlot(hash)) slot->lastUsed = ++header()->clock;
+            flock(indexFd, LOCK_UN);
+        }
+        munmap(blob, st.st_size);
+        valid ? SessionStats::shared().counters.memoHits++ : misses++;
+        return valid;
+    }
+
+    void store(const string& key, const string& out, const string& err, int status) {
+        if (!open()) return;
+        uint64_t bytes = sizeof(BlobHeader) + key.size() + out.size() + err.size();
+        if (bytes > maxBytes / 4) return;  // Not worth evicting most of the store for one entry
+
+        uint64_t hash = hashKey(key);
+        string path = blobPath(hash);
+        string tmpPath = path + ".tmp." + to_string(getpid());
+        int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+        if (fd < 0) return;
+        BlobHeader bh = {blobMagic, status, key.size(), out.size(), err.size()};
+        bool ok = ShellUtils::writeAll(fd, reinterpret_cast<const char*>(&bh), sizeof(bh)) &&
+                  ShellUtils::writeAll(fd, key.data(), key.size()) &&
+                  ShellUtils::writeAll(fd, out.data(), out.size()) &&
+                  ShellUtils::writeAll(fd, err.data(), err.size());
+        close(fd);
+        if (!ok) { unlink(tmpPath.c_str()); return; }
+
+        flock(indexFd, LOCK_EX);
+        IndexSlot* slot = findSlot(hash);
+        if (slot) *slot = {};
+        slot = reserve(bytes);
+        if (slot && rename(tmpPath.c_str(), path.c_str()) == 0) {
+            *slot = {hash, ++header()->clock, bytes, 1, status};
+        } else {
+            unlink(tmpPath.c_str());
+            unlink(path.c_str());
+        }
+        flock(indexFd, LOCK_UN);
+    }
+
+    void clear() {
+        if (!open()) return;
+        flock(indexFd, LOCK_EX);
+        IndexSlot* table = slots();
+        for (uint32_t i = 0; i < slotCount; ++i) {
+            if (table[i].used) evict(table[i]);
+        }
+        flock(indexFd, LOCK_UN);
+    }
+
+    void printSummary() {
+        if (!open()) return;
+        size_t entries = 0;
+        uint64_t bytes = 0;
+        IndexSlot* table = slots();
+        flock(indexFd, LOCK_SH);
+        for (uint32_t i = 0; i < slotCount; ++i) {
+            if (table[i].used) { entries++; bytes += table[i].bytes; }
+        }
+        flock(indexFd, LOCK_UN);
+        cout << "memo: " << dir << ": " << entries << " entries, " << bytes << " bytes (limit " << maxBytes << ")\n";
+        const auto& counters = SessionStats::shared().counters;
+        cout << "memo: this session: " << counters.memoHits << " hits, " << counters.memoMisses << " misses\n";
+    }
+};
+
+class MemoControl {
+public:
+    static constexpr const char* usage =
+        "usage: memo [-f FILE]... [-e VAR]... [--] command [args...]\n"
+        "       memo [--clear]\n";
+
+    // Strips a leading `memo [options] [--]` from args into `spec`
+    static bool parsePrefix(vector<string>& args, MemoSpec& spec, string& error) {
+        // A bare `memo` (or `memo --clear`) is the builtin that manages the store
+        if (args.size() < 2 || args[0] != "memo" || (args.size() == 2 && args[1] == "--clear")) return true;
+
+        size_t i = 1;
+        for (; i < args.size(); ++i) {
+            const string& opt = args[i];
+            bool hasValue = i + 1 < args.size();
+            if (opt == "--") { ++i; break; }
+            else if (opt == "-f" && hasValue) spec.inputFiles.push_back(args[++i]);
+            else if (opt == "-e" && hasValue) spec.envVars.push_back(args[++i]);
+            else if (!opt.empty() && opt[0] == '-') { error = "invalid option: " + opt; return false; }
+            else break;
+        }
+
+        if (i >= args.size()) { error = "missing command"; return false; }
+        spec.enabled = true;
+        args.erase(args.begin(), args.begin() + i);
+        return true;
+    }
+
+    static string fileStamp(const string& path) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) return path + ":missing";
+#ifdef __APPLE__
+        struct timespec mtime = st.st_mtimespec;
+#else
+        struct timespec mtime = st.st_mtim;
+#endif
+        return path + ":" + to_string(mtime.tv_sec) + "." + to_string(mtime.tv_nsec) + ":" +
+               to_string(st.st_size) + ":" + to_string(st.st_ino);
+    }
+
+    static string buildKey(const vector<string>& cmdArgs, const string& executable, const MemoSpec& spec) {
+        string key = "argv";
+        for (const auto& arg : cmdArgs) {
+            key += '\0';
+            key += arg;
+        }
+        key += "\nexe=" + fileStamp(executable);
+        key += "\ncwd=" + ShellUtils::getCurrentDirectory();
+        for (const auto& var : spec.envVars) {
+            const char* value = getenv(var.c_str());
+            key += "\nenv=" + var + (value ? "=" + string(value) : string(" unset"));
+        }
+        for (const auto& file : spec.inputFiles) {
+            key += "\nfile=" + fileStamp(file);
+        }
+        return key;
+    }
+};
+
+// ===== Redirections =====
+// One redirection operator, applied left to right:
+//   N> N>> N< file, &> &>> file, N>&M N<&M (dup), N>&- (close)
+struct Redirection {
+    enum Kind { Open, Dup, Close };
+    Kind kind;
+    int fd;
+    string path;     // Open
+    int flags = 0;   // Open
+    int sourceFd = -1;  // Dup
+};
+
+class Redirections {
+private:
+    static bool isNumber(const string& text) {
+        return !text.empty() && text.size() <= 4 && all_of(text.begin(), text.end(), ::isdigit);
+    }
+
+    static bool applyOne(const Redirection& r) {
+        if (r.kind == Redirection::Close) {
+            close(r.fd);
+            return true;
+        }
+        if (r.kind == Redirection::Dup) {
+            if (dup2(r.sourceFd, r.fd) < 0) {
+                cerr << r.sourceFd << ": Bad file descriptor\n";
+                return false;
+            }
+            return true;
+        }
+        int newFd = open(r.path.c_str(), r.flags, 0644);
+        if (newFd < 0) {
+            cerr << "Error opening file: " << r.path << "\n";
+            return false;
+        }
+        if (newFd != r.fd) {
+            dup2(newFd, r.fd);
+            close(newFd);
+        }
+        return true;
+    }
+
+public:
+    // Removes redirection words from `args` into `list`. Operators may be
+    // attached to their target ("2>err", "2>&1") or separated (">", "out").
+    // Quoted words (`quoted[i]`) are always plain arguments.
+    static bool parse(vector<string>& args, const vector<bool>& quoted, vector<Redirection>& list, string& error) {
+        vector<string> remaining;
+        for (size_t i = 0; i < args.size(); ++i) {
+            const string& word = args[i];
+            if (i < quoted.size() && quoted[i]) {
+                remaining.push_back(word);
+                continue;
+            }
+            size_t pos = 0;
+            bool both = false;
+            string fdText;
+            char op;
+            if (word.rfind("&>", 0) == 0) {
+                both = true;
+                op = '>';
+                pos = 2;
+            } else {
+                while (pos < word.size() && isdigit((unsigned char)word[pos])) pos++;
+                if (pos >= word.size() || (word[pos] != '>' && word[pos] != '<')) {
+                    remaining.push_back(word);
+                    continue;
+                }
+                fdText = word.substr(0, pos);
+                op = word[pos++];
+            }
+            if (!fdText.empty() && !isNumber(fdText)) {
+                error = fdText + ": Bad file descriptor";
+                return false;
+            }
+            int fd = !fdText.empty() ? stoi(fdText) : (op == '<' ? STDIN_FILENO : STDOUT_FILENO);
+
+            bool append = false, dup = false;
+            if (op == '<' && pos < word.size() && word[pos] == '<') {
+                error = "here-documents are not supported";
+                return false;
+            }
+            if (op == '>' && pos < word.size() && word[pos] == '>') { append = true; pos++; }
+            else if (!both && pos < word.size() && word[pos] == '&') { dup = true; pos++; }
+
+            string target = word.substr(pos);
+            if (target.empty()) {
+                if (i + 1 >= args.size()) {
+                    error = "syntax error near unexpected token `newline'";
+                    return false;
+                }
+                target = args[++i];
+            }
+
+            if (dup && target == "-") {
+                list.push_back({Redirection::Close, fd, "", 0, -1});
+                continue;
+            }
+            if (dup && isNumber(target)) {
+                list.push_back({Redirection::Dup, fd, "", 0, stoi(target)});
+                continue;
+            }
+            if (dup && (op != '>' || !fdText.empty())) {
+                error = target + ": ambiguous redirect";
+                return false;
+            }
+            // `>&file` is the old spelling of `&>file`
+            both = both || dup;
+
+            int flags = (op == '<') ? O_RDONLY : O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC);
+            list.push_back({Redirection::Open, fd, target, flags});
+            if (both) list.push_back({Redirection::Dup, STDERR_FILENO, "", 0, STDOUT_FILENO});
+        }
+        args = remaining;
+        return true;
+    }
+
+    // Appends what the redirections feed into a memoized command to `key`.
+    // Output redirections don't change what is captured, so they are left out.
+    // Returns false when the input can't be stamped (an fd dup or close
+    // outside stdout/stderr), in which case the command must not be cached.
+    static bool appendInputKey(const vector<Redirection>& list, string& key) {
+        for (const auto& r : list) {
+            bool output = r.fd == STDOUT_FILENO || r.fd == STDERR_FILENO;
+            if (r.kind == Redirection::Open && (r.flags & O_ACCMODE) == O_RDONLY) {
+                key += "\nredir=" + to_string(r.fd) + "<" + MemoControl::fileStamp(r.path);
+            } else if (!output || (r.kind == Redirection::Open && (r.flags & O_ACCMODE) != O_WRONLY)) {
+                return false;
+            } else if (r.kind == Redirection::Dup && r.sourceFd != STDOUT_FILENO && r.sourceFd != STDERR_FILENO) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // For a forked child about to exec; the shell's own fds are never touched
+    static bool applyInChild(const vector<Redirection>& list) {
+        for (const auto& r : list) {
+            if (!applyOne(r)) return false;
+        }
+        return true;
+    }
+
+    // For commands the shell runs itself (builtins, memo replay): applies the
+    // list, remembering the original fds in `saved` for restore()
+    static bool applyWithSave(const vector<Redirection>& list, vector<pair<int, int>>& saved) {
+        cout.flush();
+        cerr.flush();
+        fflush(stdout);
+        fflush(stderr);
+        for (const auto& r : list) {
+            bool alreadySaved = any_of(saved.begin(), saved.end(), [&](const pair<int, int>& s) { return s.first == r.fd; });
+            if (!alreadySaved) saved.push_back({r.fd, fcntl(r.fd, F_DUPFD_CLOEXEC, 64)});
+            if (!applyOne(r)) return false;
+        }
+        return true;
+    }
+
+    static void restore(vector<pair<int, int>>& saved) {
+        cout.flush();
+        cerr.flush();
+        fflush(stdout);
+        fflush(stderr);
+        for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+            if (it->second >= 0) {
+                dup2(it->second, it->first);
+                close(it->second);
+            } else {
+                close(it->first);  // Was closed before the redirection opened it
+            }
+        }
+        saved.clear();
+
+        // Writing to a closed fd (`>&-`) leaves the streams in a failed state
+        cout.clear();
+        cerr.clear();
+        clearerr(stdout);
+        clearerr(stderr);
+    }
+};
+
 // ===== Command Execution =====
 class CommandExecutor {
 private:
     HistoryManager& history;
 
-    void executeExternalCommand(const vector<string>& cmdArgs) {
-        string path;
-        
+    // Resolves the program to exec; `error` gets the message the shell has always printed
+    bool resolveExecutable(const vector<string>& cmdArgs, string& path, string& error) {
         // Check if command contains a path separator
         if (cmdArgs[0].find('/') != string::npos) {
             // This handles: ./forkdemo, /bin/ls, ../program, etc.
             path = cmdArgs[0];
             // Check if file exists and is executable
             if (access(path.c_str(), F_OK) != 0) {
-                cout << cmdArgs[0] << ": No such file or directory\n";
-                return;
+                error = cmdArgs[0] + ": No such file or directory\n";
+                return false;
             }
             if (access(path.c_str(), X_OK) != 0) {
-                cout << cmdArgs[0] << ": Permission denied\n";
-                return;
+                error = cmdArgs[0] + ": Permission denied\n";
+                return false;
             }
         } else {
             // No slash - search in PATH
             path = ShellUtils::findInPath(cmdArgs[0]);
             if (path.empty()) {
-                cout << cmdArgs[0] << ": command not found\n";
-                return;
+                error = cmdArgs[0] + ": command not found\n";
+                return false;
             }
         }
+        return true;
+    }
+
+    void executeExternalCommand(const vector<string>& cmdArgs, const vector<Redirection>& redirections,
+                                const SchedSettings& sched) {
+        string path, error;
+        if (!resolveExecutable(cmdArgs, path, error)) {
+            // Nothing is forked, so apply the redirections around the message in
+            // the shell: files are still created and the message follows stdout
+            vector<pair<int, int>> saved;
+            if (Redirections::applyWithSave(redirections, saved)) cout << error;
+            Redirections::restore(saved);
+            return;
+        }
 
+        SessionStats::shared().counters.forks++;
+        SessionStats::shared().counters.execs++;
         pid_t pid = fork();
         if (pid == 0) {
             // Child process
+            if (!Redirections::applyInChild(redirections)) exit(1);
+            if (!sched.empty()) sched.apply(cmdArgs[0]);
             vector<char*> execArgs;
             for (const auto& arg : cmdArgs) {
                 execArgs.push_back(const_cast<char*>(arg.c_str()));
@@ -436,22 +1791,105 @@ private:
             exit(1);
         } else if (pid > 0) {
             // Parent process
-            waitpid(pid, nullptr, 0);
+            struct rusage usage;
+            if (wait4(pid, nullptr, 0, &usage) == pid) SessionStats::shared().addChild(usage);
         } else {
             perror("fork failed");
         }
     }
 
-    bool setupRedirection(int& saved_fd, int fd, const string& filename, int flags) {
-        saved_fd = dup(fd);
-        int new_fd = open(filename.c_str(), flags, 0644);
-        if (new_fd < 0) {
-            cerr << "Error opening file: " << filename << "\n";
-            return false;
+    // Runs the command with stdout/stderr teed through pipes so a miss can be stored
+    void executeMemoized(const vector<string>& cmdArgs, const vector<Redirection>& redirections,
+                         const SchedSettings& sched, const MemoSpec& memo) {
+        string path, error;
+        if (!resolveExecutable(cmdArgs, path, error)) {
+            cout << error;
+            return;
+        }
+
+        string key = MemoControl::buildKey(cmdArgs, path, memo);
+        if (!Redirections::appendInputKey(redirections, key)) {
+            // Redirections are already applied to the shell's fds, so the child inherits them
+            executeExternalCommand(cmdArgs, {}, sched);
+            return;
+        }
+        if (MemoStore::shared().replay(key)) return;
+
+        int outPipe[2], errPipe[2];
+        if (pipe(outPipe) != 0) {
+            perror("pipe");
+            return;
+        }
+        if (pipe(errPipe) != 0) {
+            perror("pipe");
+            close(outPipe[0]);
+            close(outPipe[1]);
+            return;
+        }
+
+        SessionStats::shared().counters.forks++;
+        SessionStats::shared().counters.execs++;
+        pid_t pid = fork();
+        if (pid == 0) {
+            // Child process
+            dup2(outPipe[1], STDOUT_FILENO);
+            dup2(errPipe[1], STDERR_FILENO);
+            for (int fd : {outPipe[0], outPipe[1], errPipe[0], errPipe[1]}) close(fd);
+            if (!sched.empty()) sched.apply(cmdArgs[0]);
+
+            vector<char*> execArgs;
+            for (const auto& arg : cmdArgs) {
+                execArgs.push_back(const_cast<char*>(arg.c_str()));
+            }
+            execArgs.push_back(nullptr);
+            
+            execv(path.c_str(), execArgs.data());
+            perror("execv failed");
+            exit(1);
+        }
+        close(outPipe[1]);
+        close(errPipe[1]);
+        if (pid < 0) {
+            perror("fork failed");
+            close(outPipe[0]);
+            close(errPipe[0]);
+            return;
+        }
+
+        // Parent: copy both streams through while collecting them
+        string captured[2];
+        struct pollfd fds[2] = {{outPipe[0], POLLIN, 0}, {errPipe[0], POLLIN, 0}};
+        const int targets[2] = {STDOUT_FILENO, STDERR_FILENO};
+        int openStreams = 2;
+        char buf[8192];
+        while (openStreams > 0) {
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            for (int i = 0; i < 2; ++i) {
+                if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                ssize_t n = read(fds[i].fd, buf, sizeof(buf));
+                if (n > 0) {
+                    captured[i].append(buf, n);
+                    ShellUtils::writeAll(targets[i], buf, n);
+                } else if (n == 0 || errno != EINTR) {
+                    close(fds[i].fd);
+                    fds[i].fd = -1;
+                    openStreams--;
+                }
+            }
+        }
+        for (auto& fd : fds) if (fd.fd >= 0) close(fd.fd);
+
+        int status = 0;
+        struct rusage usage;
+        if (wait4(pid, &status, 0, &usage) == pid) SessionStats::shared().addChild(usage);
+        int exitStatus = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        // A command killed by a signal did not finish, so its output is not a result
+        if (WIFEXITED(status)) {
+            MemoStore::shared().store(key, captured[0], captured[1], exitStatus);
         }
-        dup2(new_fd, fd);
-        close(new_fd);
-        return true;
     }
 
     void restoreRedirection(int saved_fd, int fd) {
@@ -500,6 +1938,13 @@ public:
             }
         } else if (cmd == "history") {
             handleHistoryCommand(cmdArgs);
+        } else if (cmd == "memo") {
+            if (cmdArgs.size() >= 2 && cmdArgs[1] == "--clear") MemoStore::shared().clear();
+            else MemoStore::shared().printSummary();
+        } else if (cmd == "stats") {
+            handleStatsCommand(cmdArgs);
+        } else if (cmd == "sched") {
+            cout << "pid " << getpid() << ": " << SchedControl::current().describe() << "\n";
         }
 
         // Restore redirection
@@ -507,41 +1952,58 @@ public:
         restoreRedirection(saved_stdout, STDOUT_FILENO);
     }
 
-    void execute(const vector<string>& cmdArgs, 
-                 const string& stdoutFile = "", bool appendStdout = false,
-                 const string& stderrFile = "", bool appendStderr = false) {
-        if (cmdArgs.empty()) return;
-        
-        int saved_stdout = -1, saved_stderr = -1;
-        bool stdoutSuccess = true, stderrSuccess = true;
-
-        // Setup stdout redirection
-        if (!stdoutFile.empty()) {
-            int flags = O_WRONLY | O_CREAT | (appendStdout ? O_APPEND : O_TRUNC);
-            stdoutSuccess = setupRedirection(saved_stdout, STDOUT_FILENO, stdoutFile, flags);
+    void execute(const vector<string>& cmdArgs,
+                 const vector<Redirection>& redirections = {},
+                 const SchedSettings& sched = SchedSettings(),
+                 const MemoSpec& memo = MemoSpec()) {
+        auto timer = SessionStats::shared().start();
+
+        // Builtins and memo write their output from the shell process, so only
+        // they redirect the shell's own fds; everything else redirects in the child
+        bool inShell = cmdArgs.empty() || ShellConfig::isBuiltin(cmdArgs[0]) || memo.enabled;
+        if (inShell) {
+            vector<pair<int, int>> saved;
+            if (Redirections::applyWithSave(redirections, saved) && !cmdArgs.empty()) {
+                // Memoization is looked up before any fork of an external command
+                if (ShellConfig::isBuiltin(cmdArgs[0])) {
+                    // Builtins run in the shell itself, which must keep its own settings
+                    if (!sched.empty() || sched.verbose) cerr << "sched: settings ignored for builtin " << cmdArgs[0] << "\n";
+                    executeBuiltin(cmdArgs);
+                } else {
+                    executeMemoized(cmdArgs, redirections, sched, memo);
+                }
+            }
+            Redirections::restore(saved);
+        } else {
+            executeExternalCommand(cmdArgs, redirections, sched);
         }
 
-        // Setup stderr redirection  
-        if (!stderrFile.empty()) {
-            int flags = O_WRONLY | O_CREAT | (appendStderr ? O_APPEND : O_TRUNC);
-            stderrSuccess = setupRedirection(saved_stderr, STDERR_FILENO, stderrFile, flags);
-        }
+        if (!cmdArgs.empty()) SessionStats::shared().finish(timer, cmdArgs[0]);
+    }
 
-        // Execute command only if redirections were successful
-        if ((stdoutFile.empty() || stdoutSuccess) && (stderrFile.empty() || stderrSuccess)) {
-            if (ShellConfig::isBuiltin(cmdArgs[0])) {
-                executeBuiltin(cmdArgs);
-            } else {
-                executeExternalCommand(cmdArgs);
+private:
+    void handleStatsCommand(const vector<string>& cmdArgs) {
+        SessionStats& stats = SessionStats::shared();
+        if (cmdArgs.size() < 2) {
+            stats.print(cout);
+        } else if (cmdArgs[1] == "reset") {
+            stats.reset();
+        } else if (cmdArgs[1] == "--json") {
+            if (cmdArgs.size() < 3) {
+                stats.printJson(cout);
+                return;
             }
+            ofstream file(cmdArgs[2]);
+            if (!file.is_open()) {
+                cerr << "Error opening file: " << cmdArgs[2] << "\n";
+                return;
+            }
+            stats.printJson(file);
+        } else {
+            cerr << "usage: stats [reset | --json [FILE]]\n";
         }
-
-        // Restore redirection
-        restoreRedirection(saved_stdout, STDOUT_FILENO);
-        restoreRedirection(saved_stderr, STDERR_FILENO);
     }
 
-private:
     void handleHistoryCommand(const vector<string>& cmdArgs) {
         if (cmdArgs.size() >= 3) {
             string flag = cmdArgs[1], filename = cmdArgs[2];
@@ -586,81 +2048,50 @@ private:
         tcsetattr(STDIN_FILENO, TCSANOW, &old_tio);
     }
 
-    vector<vector<string>> parsePipeline(const vector<string>& args) {
+    // Splits on unquoted "|"; `stageQuoted` gets the quoted flags per stage
+    vector<vector<string>> parsePipeline(const vector<string>& args, const vector<bool>& quoted,
+                                         vector<vector<bool>>& stageQuoted) {
         vector<vector<string>> commands;
         vector<string> currentCmd;
+        vector<bool> currentQuoted;
         
-        for (const auto& arg : args) {
-            if (arg == "|") {
-                if (!currentCmd.empty()) commands.push_back(currentCmd);
+        for (size_t i = 0; i < args.size(); ++i) {
+            bool isQuoted = i < quoted.size() && quoted[i];
+            if (args[i] == "|" && !isQuoted) {
+                if (!currentCmd.empty()) {
+                    commands.push_back(currentCmd);
+                    stageQuoted.push_back(currentQuoted);
+                }
                 currentCmd.clear();
+                currentQuoted.clear();
             } else {
-                currentCmd.push_back(arg);
+                currentCmd.push_back(args[i]);
+                currentQuoted.push_back(isQuoted);
             }
         }
-        if (!currentCmd.empty()) commands.push_back(currentCmd);
-        return commands;
-    }
-
-    struct RedirectionInfo {
-        string stdoutFile;
-        string stderrFile;
-        bool appendStdout = false;
-        bool appendStderr = false;
-        vector<string> filteredArgs;
-    };
-
-    RedirectionInfo parseRedirections(const vector<string>& args) {
-        RedirectionInfo info;
-        info.filteredArgs = args;
-
-        for (size_t i = 0; i < info.filteredArgs.size(); ) {
-            const string& arg = info.filteredArgs[i];
-            
-            if (arg == ">" || arg == "1>") {
-                if (i + 1 < info.filteredArgs.size()) {
-                    info.stdoutFile = info.filteredArgs[i + 1];
-                    info.appendStdout = false;
-                    info.filteredArgs.erase(info.filteredArgs.begin() + i, info.filteredArgs.begin() + i + 2);
-                } else {
-                    i++;
-                }
-            } else if (arg == ">>" || arg == "1>>") {
-                if (i + 1 < info.filteredArgs.size()) {
-                    info.stdoutFile = info.filteredArgs[i + 1];
-                    info.appendStdout = true;
-                    info.filteredArgs.erase(info.filteredArgs.begin() + i, info.filteredArgs.begin() + i + 2);
-                } else {
-                    i++;
-                }
-            } else if (arg == "2>") {
-                if (i + 1 < info.filteredArgs.size()) {
-                    info.stderrFile = info.filteredArgs[i + 1];
-                    info.appendStderr = false;
-                    info.filteredArgs.erase(info.filteredArgs.begin() + i, info.filteredArgs.begin() + i + 2);
-                } else {
-                    i++;
-                }
-            } else if (arg == "2>>") {
-                if (i + 1 < info.filteredArgs.size()) {
-                    info.stderrFile = info.filteredArgs[i + 1];
-                    info.appendStderr = true;
-                    info.filteredArgs.erase(info.filteredArgs.begin() + i, info.filteredArgs.begin() + i + 2);
-                } else {
-                    i++;
-                }
-            } else {
-                i++;
-            }
+        if (!currentCmd.empty()) {
+            commands.push_back(currentCmd);
+            stageQuoted.push_back(currentQuoted);
         }
-
-        return info;
+        return commands;
     }
 
-    void executePipeline(const vector<vector<string>>& commands) {
+    void executePipeline(const vector<vector<string>>& commands,
+                         const vector<vector<Redirection>>& redirections,
+                         const vector<SchedSettings>& sched) {
         int numCommands = commands.size();
         vector<pid_t> pids;
         vector<vector<int>> pipes(numCommands - 1, vector<int>(2));
+        SessionStats& stats = SessionStats::shared();
+        auto timer = stats.start();
+
+        // Resolve programs up front so the lookups happen (and are counted) in the shell
+        vector<string> paths(numCommands);
+        for (int i = 0; i < numCommands; i++) {
+            if (!commands[i].empty() && !ShellConfig::isBuiltin(commands[i][0])) {
+                paths[i] = ShellUtils::findInPath(commands[i][0]);
+            }
+        }
 
         // Create pipes
         for (int i = 0; i < numCommands - 1; i++) {
@@ -672,6 +2103,9 @@ private:
 
         // Execute commands
         for (int i = 0; i < numCommands; i++) {
+            bool builtin = commands[i].empty() || ShellConfig::isBuiltin(commands[i][0]);
+            stats.counters.forks++;
+            if (!builtin) stats.counters.execs++;
             pid_t pid = fork();
             if (pid == 0) {
                 // Child process
@@ -683,7 +2117,12 @@ private:
                     close(pipes[j][1]);
                 }
                 
-                if (ShellConfig::isBuiltin(commands[i][0])) {
+                // Stage redirections come after the pipe so they take precedence
+                if (!Redirections::applyInChild(redirections[i])) exit(1);
+                if (commands[i].empty()) exit(0);
+                if (!sched[i].empty()) sched[i].apply(commands[i][0]);
+                
+                if (builtin) {
                     executor.executeBuiltin(commands[i]);
                     exit(0);
                 } else {
@@ -693,7 +2132,7 @@ private:
                     }
                     execArgs.push_back(nullptr);
                     
-                    string path = ShellUtils::findInPath(commands[i][0]);
+                    const string& path = paths[i];
                     if (path.empty()) {
                         cerr << commands[i][0] << ": command not found\n";
                         exit(1);
@@ -712,7 +2151,80 @@ private:
             close(pipes[i][0]);
             close(pipes[i][1]);
         }
-        for (pid_t pid : pids) waitpid(pid, nullptr, 0);
+        for (pid_t pid : pids) {
+            struct rusage usage;
+            if (wait4(pid, nullptr, 0, &usage) == pid) stats.addChild(usage);
+        }
+        stats.finishPipeline(timer, commands);
+    }
+
+    // Strips `sched` and `memo` prefixes in either order, so `memo sched -c 0 cmd`
+    // and `sched -c 0 memo cmd` mean the same. Reports and returns false on error.
+    static bool parsePrefixes(vector<string>& cmdArgs, SchedSettings& sched, MemoSpec& memo) {
+        string error;
+        bool schedSeen = false, memoSeen = false;
+        while (!cmdArgs.empty()) {
+            size_t before = cmdArgs.size();
+            if (cmdArgs[0] == "sched" && !schedSeen) {
+                schedSeen = true;
+                if (!SchedControl::parsePrefix(cmdArgs, sched, error)) {
+                    cerr << "sched: " << error << "\n" << SchedControl::usage;
+                    return false;
+                }
+            } else if (cmdArgs[0] == "memo" && !memoSeen) {
+                memoSeen = true;
+                if (!MemoControl::parsePrefix(cmdArgs, memo, error)) {
+                    cerr << "memo: " << error << "\n" << MemoControl::usage;
+                    return false;
+                }
+            } else {
+                break;
+            }
+            // A bare builtin form (`sched`, `memo --clear`) is left in place
+            if (cmdArgs.size() == before) break;
+        }
+        return true;
+    }
+
+    void executeCommandLine(const vector<string>& args, const vector<bool>& quoted) {
+        string error;
+
+        // Redirections are parsed per stage and applied in that stage's child
+        vector<vector<bool>> stageQuoted;
+        auto commands = parsePipeline(args, quoted, stageQuoted);
+        vector<vector<Redirection>> redirections(commands.size());
+        for (size_t i = 0; i < commands.size(); ++i) {
+            if (!Redirections::parse(commands[i], stageQuoted[i], redirections[i], error)) {
+                cerr << error << "\n";
+                return;
+            }
+        }
+
+        // Handle pipelines
+        if (commands.size() > 1) {
+            vector<SchedSettings> sched(commands.size());
+            for (size_t i = 0; i < commands.size(); ++i) {
+                // Stages stream into each other, so `memo` is accepted but not cached there
+                MemoSpec memo;
+                if (!parsePrefixes(commands[i], sched[i], memo)) return;
+            }
+            if (!SchedControl::resolvePipeline(sched, error)) {
+                cerr << "sched: " << error << "\n" << SchedControl::usage;
+                return;
+            }
+            executePipeline(commands, redirections, sched);
+            return;
+        }
+        if (commands.empty()) return;
+
+        SchedSettings sched;
+        MemoSpec memo;
+        vector<string>& cmdArgs = commands[0];
+        if (!parsePrefixes(cmdArgs, sched, memo)) return;
+
+        // A bare redirection (`> file`) still creates or truncates its file
+        if (cmdArgs.empty() && redirections[0].empty()) return;
+        executor.execute(cmdArgs, redirections[0], sched, memo);
     }
 
 public:
@@ -736,10 +2248,13 @@ public:
             string line = input.readLine();
             restoreTerminal();
 
+            // Input closed (e.g. piped script ended without `exit`)
+            if (line.empty() && input.atEof()) return;
             if (line.empty()) continue;
 
             history.add(line);
-            vector<string> args = ShellUtils::parseInput(line);
+            vector<bool> quoted;
+            vector<string> args = ShellUtils::parseInput(line, &quoted);
 
             if (args.empty()) continue;
 
@@ -752,20 +2267,7 @@ public:
                 return;
             }
 
-            // Handle pipelines
-            auto commands = parsePipeline(args);
-            if (commands.size() > 1) {
-                executePipeline(commands);
-            } else {
-                // Parse and handle redirections for single command
-                RedirectionInfo redirInfo = parseRedirections(args);
-                if (redirInfo.filteredArgs.empty()) continue;
-                
-                executor.execute(redirInfo.filteredArgs,
-                                redirInfo.stdoutFile, redirInfo.appendStdout,
-                                redirInfo.stderrFile, redirInfo.appendStderr);
-            }
-
+            executeCommandLine(args, quoted);
             setupTerminal();
         }
     }